@@ -19,6 +19,15 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <new>
 
 
 void safeJoin(std::thread& th) {
@@ -33,8 +42,175 @@ void safeJoin(std::thread& th) {
 }
 
 
-P2PServer::P2PServer(int index, int n, int tcpPort) 
-    : index(index), n(n), tcpPort(tcpPort), udpPort(ROOT_ID + index), tcpSocket(-1), udpSocket(-1), running(false) {
+std::string shmRingName(int port) {
+    return std::string(SHM_NAME_PREFIX) + std::to_string(port);
+}
+
+
+void futexWait(std::atomic<uint32_t>* word, uint32_t expected, int timeoutMs) {
+    struct timespec timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+}
+
+
+void futexWake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+
+// Multi-producer push: claim a slot with a CAS on enqueuePos, then publish it through its sequence.
+bool ringPush(ShmRing* ring, const std::string& message) {
+    uint64_t pos = ring->enqueuePos.load(std::memory_order_relaxed);
+    ShmSlot* slot;
+    while (true) {
+        slot = &ring->slots[pos & (SHM_RING_SLOTS - 1)];
+        uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            if (ring->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // Ring is full
+        } else {
+            pos = ring->enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    memcpy(slot->data, message.data(), message.size());
+    slot->length = static_cast<uint32_t>(message.size());
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    // Only pay for a syscall when the owner is actually parked on the futex
+    ring->wakeSeq.fetch_add(1);
+    if (ring->sleeping.load()) {
+        futexWake(&ring->wakeSeq);
+    }
+    return true;
+}
+
+
+// Single-consumer pop, only ever called by the ring's owner.
+bool ringPop(ShmRing* ring, std::string& message) {
+    uint64_t pos = ring->dequeuePos.load(std::memory_order_relaxed);
+    ShmSlot* slot = &ring->slots[pos & (SHM_RING_SLOTS - 1)];
+    if (slot->sequence.load(std::memory_order_acquire) != pos + 1) {
+        return false;
+    }
+    message.assign(slot->data, slot->length);
+    slot->sequence.store(pos + SHM_RING_SLOTS, std::memory_order_release);
+    ring->dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+
+TimerWheel::TimerWheel() : tick(0), size(0) {}
+
+
+// Returns the expiry tick actually used, which cancel() needs to find the timer again
+uint64_t TimerWheel::schedule(uint64_t id, uint64_t expiryTick) {
+    uint64_t maxExpiryTick = tick + (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+    expiryTick = std::max(expiryTick, tick + 1);
+    expiryTick = std::min(expiryTick, maxExpiryTick);
+    place({id, expiryTick});
+    size++;
+    return expiryTick;
+}
+
+
+// A pending timer sits in exactly one level, in the slot its expiry tick maps to at that level
+bool TimerWheel::cancel(uint64_t id, uint64_t expiryTick) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint64_t slot = (expiryTick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+        std::vector<Timer>& timers = slots[level][slot];
+        for (auto timerIt = timers.begin(); timerIt != timers.end(); ++timerIt) {
+            if (timerIt->id == id) {
+                timers.erase(timerIt);
+                size--;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+void TimerWheel::place(const Timer& timer) {
+    uint64_t delta = timer.expiryTick > tick ? timer.expiryTick - tick : 0;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (delta < (1ULL << (TIMER_WHEEL_BITS * (level + 1))) || level == TIMER_WHEEL_LEVELS - 1) {
+            uint64_t slot = (timer.expiryTick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+            slots[level][slot].push_back(timer);
+            return;
+        }
+    }
+}
+
+
+void TimerWheel::cascade(int level) {
+    uint64_t slot = (tick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+    std::vector<Timer> timers;
+    timers.swap(slots[level][slot]);
+    for (const auto& timer : timers) {
+        place(timer);
+    }
+}
+
+
+void TimerWheel::advance(uint64_t nowTick, std::vector<uint64_t>& expired) {
+    if (size == 0) {
+        tick = std::max(tick, nowTick);
+        return;
+    }
+
+    while (tick < nowTick) {
+        tick++;
+
+        // When a lower level wraps, pull the next slot of the level above down into it
+        for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            if ((tick & ((1ULL << (TIMER_WHEEL_BITS * level)) - 1)) == 0) {
+                cascade(level);
+            }
+        }
+
+        std::vector<Timer> timers;
+        timers.swap(slots[0][tick & (TIMER_WHEEL_SLOTS - 1)]);
+        for (const auto& timer : timers) {
+            if (timer.expiryTick <= tick) {
+                expired.push_back(timer.id);
+                size--;
+            } else {
+                place(timer);
+            }
+        }
+    }
+}
+
+
+uint64_t TimerWheel::nextExpiryTick() const {
+    uint64_t nextTick = UINT64_MAX;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            for (const auto& timer : slots[level][slot]) {
+                nextTick = std::min(nextTick, timer.expiryTick);
+            }
+        }
+    }
+    return nextTick;
+}
+
+
+bool TimerWheel::empty() const {
+    return size == 0;
+}
+
+
+P2PServer::P2PServer(int index, int n, int tcpPort, Transport transport, int rumorFanout) 
+    : index(index), n(n), tcpPort(tcpPort), udpPort(ROOT_ID + index), tcpSocket(-1), udpSocket(-1),
+      transport(transport), shmRing(nullptr), shmRetired(false), shmRingDev(0), shmRingIno(0), rumorFanout(rumorFanout), nextRumorId(0),
+      wheelEpoch(std::chrono::steady_clock::now()), running(false) {
     database[udpPort] = DatabaseEntry();
 }
 
@@ -47,9 +223,16 @@ P2PServer::~P2PServer() {
 
 void P2PServer::start() {
     running.store(true);
+    if (transport == Transport::SHM) {
+        initializeSharedMemory();
+    }
     proxyThread = std::thread(&P2PServer::proxyCommunication, this);
     neighborThread = std::thread(&P2PServer::neighborCommunication, this);
     statusBroadcastThread = std::thread(&P2PServer::broadcastStatusPeriodically, this);
+    retransmitThread = std::thread(&P2PServer::retransmitRumorsPeriodically, this);
+    if (transport == Transport::SHM) {
+        shmThread = std::thread(&P2PServer::shmCommunication, this);
+    }
 }
 
 
@@ -68,11 +251,18 @@ void P2PServer::shutdownServer() {
         udpSocket = -1;
     }
 
+    retireSharedMemory();
+
     cv.notify_all();
+    retransmitCv.notify_all();
 
     safeJoin(proxyThread);
     safeJoin(neighborThread);
     safeJoin(statusBroadcastThread);
+    safeJoin(retransmitThread);
+    safeJoin(shmThread);
+
+    closeSharedMemory();
 }
 
 
@@ -88,6 +278,7 @@ void P2PServer::initializeTCPConnection() {
     tcpSocket = socket(AF_INET, SOCK_STREAM, 0);
     if (tcpSocket < 0) {
         std::cerr << "Failed to create TCP socket." << std::endl;
+        retireSharedMemory();
         exit(EXIT_FAILURE);
     }
 
@@ -99,11 +290,13 @@ void P2PServer::initializeTCPConnection() {
     
     if (bind(tcpSocket, (struct sockaddr *)&serverAddr, sizeof(serverAddr)) < 0) {
         std::cerr << "Failed to bind TCP socket." << std::endl;
+        retireSharedMemory();
         exit(EXIT_FAILURE);
     }
 
     if (listen(tcpSocket, MAX_PEERS) < 0) {
         std::cerr << "Failed to listen on socket." << std::endl;
+        retireSharedMemory();
         exit(EXIT_FAILURE);
     }
 
@@ -206,6 +399,14 @@ void P2PServer::storeMessage(const std::string& messageText) {
 }
 
 
+bool P2PServer::sendGossipMessage(int receiverPort, const std::string& message) {
+    if (transport == Transport::SHM && sendShmMessage(receiverPort, message)) {
+        return true;
+    }
+    return sendUDPMessage(receiverPort, message);
+}
+
+
 bool P2PServer::sendUDPMessage(int receiverPort, const std::string& message) {
 
     int sockfd;
@@ -233,12 +434,24 @@ bool P2PServer::sendUDPMessage(int receiverPort, const std::string& message) {
 
 
 void P2PServer::sendRumorMessage(int messageOwner, const std::string& messageText, int seqnum) {
-    int receiverPort = P2PServer::pickANeighbor(-1);
-    if (receiverPort != -1){
-        std::string message = constructRumorMessage(messageOwner, messageText, seqnum);
-        sendUDPMessage(receiverPort, message);
-    } else {
+    std::vector<int> neighbors = getNeighbors();
+    if (neighbors.empty()) {
         std::cout << "## P2PServer::sendRumorMessage no neighbor to talk to" << std::endl;
+        return;
+    }
+
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::shuffle(neighbors.begin(), neighbors.end(), gen);
+    if (static_cast<int>(neighbors.size()) > rumorFanout) {
+        neighbors.resize(rumorFanout);
+    }
+
+    std::string message = constructRumorMessage(messageOwner, messageText, seqnum);
+    for (int receiverPort : neighbors) {
+        // Track before sending so an ack racing back on another thread is never missed
+        trackRumor(receiverPort, messageOwner, seqnum, message);
+        sendGossipMessage(receiverPort, message);
     }
 }
 
@@ -337,6 +550,7 @@ void P2PServer::neighborCommunication() {
         if (bytesRead > 0) {
             buffer[bytesRead] = '\0'; // Ensure null-termination
             std::string message(buffer);
+            std::lock_guard<std::mutex> lock(gossipMutex);
             handleGossipMessage(message);
         }
     }
@@ -396,7 +610,7 @@ void P2PServer::handleRumorMessage(const std::string& message) {
     }
 
     std::string statusMessage = constructStatusMessage(ownerPort);
-    sendUDPMessage(receiverPort, statusMessage);
+    sendGossipMessage(receiverPort, statusMessage);
 }
 
 
@@ -449,6 +663,8 @@ void P2PServer::handleStatusMessage(const std::string& message){
         statusPairs.emplace_back(ownerUdpPort, theirSeqNum);
     }
 
+    acknowledgeRumors(receiverPort, statusPairs);
+
     /* 1. Check if first owner's message is aligned
         case 1: sender's seq == mine: jump to 2.
         case 2: sender's seq < mine: send rumor to sender for this msg
@@ -468,7 +684,7 @@ void P2PServer::handleStatusMessage(const std::string& message){
             if (mySeqNum < theirSeqNum) {
                 // std::cout << "I am " << udpPort << ". Why you (" << receiverPort << ") requesting from me, you have more than I do, I want to know about " << ownerPort << std::endl;
                 std::string statusMessage = constructStatusMessage(ownerPort);
-                sendUDPMessage(receiverPort, statusMessage);
+                sendGossipMessage(receiverPort, statusMessage);
                 databaseAligned = false; 
                 return;
             } else if (mySeqNum > theirSeqNum) {
@@ -483,7 +699,7 @@ void P2PServer::handleStatusMessage(const std::string& message){
             if (theirSeqNum > database[ownerPort].lowestSeqNum){
                 // std::cout << "I am " << udpPort << ". you have gossip for " << ownerPort << " I wanna know! tell me port " << receiverPort << std::endl;
                 std::string statusMessage = constructStatusMessage(ownerPort);
-                sendUDPMessage(receiverPort, statusMessage);
+                sendGossipMessage(receiverPort, statusMessage);
                 databaseAligned = false;
                 return;
             }
@@ -498,7 +714,7 @@ void P2PServer::handleStatusMessage(const std::string& message){
             int newReceiverPort = pickANeighbor(receiverPort);
             if (newReceiverPort != -1){
                 std::string statusMessage = constructStatusMessage(udpPort);
-                sendUDPMessage(newReceiverPort, statusMessage);
+                sendGossipMessage(newReceiverPort, statusMessage);
             }
         }
     }
@@ -516,7 +732,8 @@ void P2PServer::sendMissingMessages(int receiverPort, int originPort, int needed
     auto messageIt = messages.find(neededSeqNum);
     if (messageIt != messages.end()) {
         std::string rumorMessage = constructRumorMessage(originPort, messageIt->second, messageIt->first);
-        sendUDPMessage(receiverPort, rumorMessage);
+        trackRumor(receiverPort, originPort, messageIt->first, rumorMessage);
+        sendGossipMessage(receiverPort, rumorMessage);
     }
 }
 
@@ -525,6 +742,7 @@ void P2PServer::initializeUDPConnection() {
     struct sockaddr_in udpAddr;
     if ((udpSocket = socket(AF_INET, SOCK_DGRAM, 0))< 0) {
         std::cerr << "Failed to create UDP socket." << std::endl;
+        retireSharedMemory();
         exit(EXIT_FAILURE);
     }
 
@@ -535,6 +753,7 @@ void P2PServer::initializeUDPConnection() {
 
     if (bind(udpSocket, (const struct sockaddr *)&udpAddr, sizeof(udpAddr)) < 0) {
         std::cerr << "Failed to bind UDP socket." << std::endl;
+        retireSharedMemory();
         exit(EXIT_FAILURE);
     }
 }
@@ -550,6 +769,12 @@ void P2PServer::waitForThreadsToFinish() {
     if (statusBroadcastThread.joinable()){
         statusBroadcastThread.join();
     }
+    if (retransmitThread.joinable()){
+        retransmitThread.join();
+    }
+    if (shmThread.joinable()){
+        shmThread.join();
+    }
 }
 
 
@@ -566,7 +791,348 @@ void P2PServer::broadcastStatusToNeighbors(){
     std::string statusMessage = constructStatusMessage(udpPort);
 
     for (int neighborPort : neighbors) {
-        sendUDPMessage(neighborPort, statusMessage);
+        sendGossipMessage(neighborPort, statusMessage);
+    }
+}
+
+
+void P2PServer::retransmitRumorsPeriodically() {
+    while (running.load()) {
+        std::vector<OutstandingRumor> dueRumors;
+        {
+            std::unique_lock<std::mutex> lock(rumorMutex);
+            if (retransmitWheel.empty()) {
+                retransmitCv.wait_for(lock, std::chrono::seconds(1)); // Woken by trackRumor or shutdownServer
+            } else {
+                // Sleep until the earliest timer; trackRumor wakes us if it schedules an earlier one
+                uint64_t nextTick = retransmitWheel.nextExpiryTick();
+                uint64_t nowTick = currentTick();
+                if (nextTick > nowTick) {
+                    retransmitCv.wait_for(lock, std::chrono::milliseconds((nextTick - nowTick) * TIMER_TICK_MS));
+                }
+            }
+
+            uint64_t nowTick = currentTick();
+            std::vector<uint64_t> expired;
+            retransmitWheel.advance(nowTick, expired);
+
+            for (uint64_t timerId : expired) {
+                auto rumorIt = outstandingRumors.find(timerId);
+                if (rumorIt == outstandingRumors.end()) {
+                    continue; // Already acknowledged
+                }
+                OutstandingRumor& rumor = rumorIt->second;
+                if (rumor.retries >= MAX_RUMOR_RETRIES) {
+                    // Give up and leave it to anti-entropy
+                    outstandingByNeighbor[rumor.neighborPort].erase(std::make_pair(rumor.ownerPort, rumor.seqnum));
+                    outstandingRumors.erase(rumorIt);
+                    continue;
+                }
+                rumor.retries++;
+                rumor.retransmitted = true;
+                rumor.sentAt = std::chrono::steady_clock::now();
+                int backoffMs = std::min(rttEstimates[rumor.neighborPort].rtoMs << rumor.retries, RUMOR_MAX_RTO_MS);
+                rumor.expiryTick = retransmitWheel.schedule(timerId, nowTick + backoffMs / TIMER_TICK_MS);
+                dueRumors.push_back(rumor);
+            }
+        }
+
+        for (const auto& rumor : dueRumors) {
+            sendGossipMessage(rumor.neighborPort, rumor.message);
+        }
+    }
+}
+
+
+uint64_t P2PServer::currentTick() const {
+    auto elapsed = std::chrono::steady_clock::now() - wheelEpoch;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() / TIMER_TICK_MS;
+}
+
+
+void P2PServer::trackRumor(int neighborPort, int ownerPort, int seqnum, const std::string& message) {
+    std::lock_guard<std::mutex> lock(rumorMutex);
+
+    // A neighbor that keeps asking for the same rumor is already covered by its pending timer, but the
+    // rumor has now gone out twice and its ack can no longer be matched to a single send
+    auto& neighborRumors = outstandingByNeighbor[neighborPort];
+    auto pendingIt = neighborRumors.find(std::make_pair(ownerPort, seqnum));
+    if (pendingIt != neighborRumors.end()) {
+        outstandingRumors[pendingIt->second].retransmitted = true;
+        return;
+    }
+
+    uint64_t timerId = nextRumorId++;
+
+    OutstandingRumor rumor;
+    rumor.neighborPort = neighborPort;
+    rumor.ownerPort = ownerPort;
+    rumor.seqnum = seqnum;
+    rumor.message = message;
+    rumor.sentAt = std::chrono::steady_clock::now();
+    rumor.expiryTick = retransmitWheel.schedule(timerId, currentTick() + rttEstimates[neighborPort].rtoMs / TIMER_TICK_MS);
+    outstandingRumors[timerId] = rumor;
+    neighborRumors[std::make_pair(ownerPort, seqnum)] = timerId;
+
+    retransmitCv.notify_all();
+}
+
+
+void P2PServer::acknowledgeRumors(int neighborPort, const std::vector<std::pair<int, int>>& statusPairs) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(rumorMutex);
+
+    auto neighborIt = outstandingByNeighbor.find(neighborPort);
+    if (neighborIt == outstandingByNeighbor.end()) {
+        return;
+    }
+    auto& neighborRumors = neighborIt->second;
+
+    // Each status pair acknowledges every rumor of that owner below the neighbor's next expected seqnum
+    for (const auto& pair : statusPairs) {
+        auto first = neighborRumors.lower_bound(std::make_pair(pair.first, INT_MIN));
+        auto last = neighborRumors.lower_bound(std::make_pair(pair.first, pair.second));
+        for (auto pendingIt = first; pendingIt != last; ++pendingIt) {
+            auto rumorIt = outstandingRumors.find(pendingIt->second);
+            const OutstandingRumor& rumor = rumorIt->second;
+
+            // Karn's algorithm: only rumors sent exactly once give an unambiguous RTT sample
+            if (!rumor.retransmitted) {
+                std::chrono::duration<double, std::milli> sample = now - rumor.sentAt;
+                updateRttEstimate(neighborPort, sample.count());
+            }
+            retransmitWheel.cancel(rumorIt->first, rumor.expiryTick);
+            outstandingRumors.erase(rumorIt);
+        }
+        neighborRumors.erase(first, last);
+    }
+}
+
+
+// Caller must hold rumorMutex
+void P2PServer::updateRttEstimate(int neighborPort, double sampleMs) {
+    RttEstimate& estimate = rttEstimates[neighborPort];
+    if (!estimate.measured) {
+        estimate.srttMs = sampleMs;
+        estimate.rttvarMs = sampleMs / 2;
+        estimate.measured = true;
+    } else {
+        estimate.rttvarMs = 0.75 * estimate.rttvarMs + 0.25 * std::fabs(estimate.srttMs - sampleMs);
+        estimate.srttMs = 0.875 * estimate.srttMs + 0.125 * sampleMs;
+    }
+    int rtoMs = static_cast<int>(std::ceil(estimate.srttMs + 4 * estimate.rttvarMs));
+    estimate.rtoMs = std::min(std::max(rtoMs, RUMOR_MIN_RTO_MS), RUMOR_MAX_RTO_MS);
+}
+
+
+void P2PServer::shmCommunication() {
+    std::cout << "## P2PServer::shmCommunication ring: " << shmRingName(udpPort) << std::endl;
+
+    std::string message;
+    while (running.load()) {
+        if (ringPop(shmRing, message)) {
+            std::lock_guard<std::mutex> lock(gossipMutex);
+            handleGossipMessage(message);
+            continue;
+        }
+
+        // Announce that we are about to sleep, then re-check so a concurrent push is never missed
+        shmRing->sleeping.store(1);
+        uint32_t seq = shmRing->wakeSeq.load();
+        if (ringPop(shmRing, message)) {
+            shmRing->sleeping.store(0);
+            std::lock_guard<std::mutex> lock(gossipMutex);
+            handleGossipMessage(message);
+            continue;
+        }
+        futexWait(&shmRing->wakeSeq, seq, SHM_WAIT_TIMEOUT_MS);
+        shmRing->sleeping.store(0);
+    }
+}
+
+
+void P2PServer::initializeSharedMemory() {
+    std::string name = shmRingName(udpPort);
+
+    // Retire a ring left behind by a previous incarnation so neighbors holding it fall back and re-attach
+    int staleFd = shm_open(name.c_str(), O_RDWR, 0);
+    if (staleFd >= 0) {
+        struct stat st;
+        if (fstat(staleFd, &st) == 0 && st.st_size == static_cast<off_t>(sizeof(ShmRing))) {
+            void* addr = mmap(nullptr, sizeof(ShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, staleFd, 0);
+            if (addr != MAP_FAILED) {
+                static_cast<ShmRing*>(addr)->ready.store(0);
+                munmap(addr, sizeof(ShmRing));
+            }
+        }
+        close(staleFd);
+        shm_unlink(name.c_str());
+    }
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        std::cerr << "Failed to create shared memory ring: " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    struct stat st;
+    if (ftruncate(fd, sizeof(ShmRing)) < 0 || fstat(fd, &st) < 0) {
+        std::cerr << "Failed to size shared memory ring: " << strerror(errno) << std::endl;
+        close(fd);
+        shm_unlink(name.c_str());
+        exit(EXIT_FAILURE);
+    }
+    void* addr = mmap(nullptr, sizeof(ShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory ring: " << strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    std::lock_guard<std::mutex> lock(shmRingMutex);
+    shmRingDev = st.st_dev;
+    shmRingIno = st.st_ino;
+    shmRing = new (addr) ShmRing;
+    shmRing->wakeSeq.store(0);
+    shmRing->sleeping.store(0);
+    shmRing->ownerPid = getpid();
+    shmRing->enqueuePos.store(0);
+    shmRing->dequeuePos.store(0);
+    for (int i = 0; i < SHM_RING_SLOTS; i++) {
+        shmRing->slots[i].sequence.store(i);
+    }
+    shmRing->ready.store(1, std::memory_order_release);
+}
+
+
+// Tell neighbors to stop pushing and drop the name so nothing is left in /dev/shm. Safe to call more than
+// once and from any thread (crash, a later SIGTERM, or a socket setup failure).
+void P2PServer::retireSharedMemory() {
+    std::lock_guard<std::mutex> lock(shmRingMutex);
+    if (shmRing == nullptr || shmRetired) {
+        return;
+    }
+    shmRetired = true;
+
+    shmRing->ready.store(0);
+    shmRing->wakeSeq.fetch_add(1);
+    futexWake(&shmRing->wakeSeq);
+
+    // Only unlink the name if it still refers to our ring and not one a restarted node created since
+    std::string name = shmRingName(udpPort);
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_dev == shmRingDev && st.st_ino == shmRingIno) {
+            shm_unlink(name.c_str());
+        }
+        close(fd);
+    }
+}
+
+
+void P2PServer::closeSharedMemory() {
+    {
+        std::lock_guard<std::mutex> lock(peerRingsMutex);
+        for (const auto& peerRing : peerRings) {
+            munmap(peerRing.second, sizeof(ShmRing));
+        }
+        peerRings.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(shmRingMutex);
+    if (shmRing != nullptr) {
+        munmap(shmRing, sizeof(ShmRing));
+        shmRing = nullptr;
+    }
+}
+
+
+ShmRing* P2PServer::attachPeerRing(int peerPort) {
+    auto ringIt = peerRings.find(peerPort);
+    if (ringIt != peerRings.end()) {
+        return ringIt->second;
+    }
+
+    // Remember misses so UDP-only neighbors do not cost a failing shm_open on every send
+    auto now = std::chrono::steady_clock::now();
+    auto retryIt = peerRingRetryAt.find(peerPort);
+    if (retryIt != peerRingRetryAt.end() && now < retryIt->second) {
+        return nullptr;
+    }
+    peerRingRetryAt[peerPort] = now + std::chrono::milliseconds(SHM_ATTACH_RETRY_MS);
+
+    int fd = shm_open(shmRingName(peerPort).c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return nullptr; // Peer is not running the shared-memory transport
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size != static_cast<off_t>(sizeof(ShmRing))) {
+        close(fd);
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, sizeof(ShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return nullptr;
+    }
+
+    ShmRing* ring = static_cast<ShmRing*>(addr);
+    if (ring->ready.load(std::memory_order_acquire) == 0 || kill(ring->ownerPid, 0) < 0) {
+        munmap(addr, sizeof(ShmRing));
+        return nullptr;
+    }
+    peerRingRetryAt.erase(peerPort);
+    peerRings[peerPort] = ring;
+    return ring;
+}
+
+
+void P2PServer::detachPeerRing(int peerPort) {
+    auto ringIt = peerRings.find(peerPort);
+    if (ringIt != peerRings.end()) {
+        munmap(ringIt->second, sizeof(ShmRing));
+        peerRings.erase(ringIt);
+    }
+}
+
+
+bool P2PServer::sendShmMessage(int receiverPort, const std::string& message) {
+    if (message.size() >= MAX_BUFFER_SIZE) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(peerRingsMutex);
+    ShmRing* ring = attachPeerRing(receiverPort);
+    if (ring == nullptr) {
+        return false;
+    }
+
+    // A retired ring means the peer shut down
+    if (ring->ready.load(std::memory_order_acquire) == 0) {
+        detachPeerRing(receiverPort);
+        return false;
+    }
+
+    // A full ring usually means a live peer is just behind: send this frame over UDP and keep the mapping,
+    // unless the owner died without retiring its ring
+    if (!ringPush(ring, message)) {
+        if (kill(ring->ownerPid, 0) < 0 && errno == ESRCH) {
+            detachPeerRing(receiverPort);
+        }
+        return false;
+    }
+    return true;
+}
+
+
+// stopall and ctrl+c end the process with SIGTERM/SIGINT, so retire the shared-memory ring before exiting
+void waitForStopSignal(P2PServer& server, sigset_t signals) {
+    int signal;
+    if (sigwait(&signals, &signal) == 0) {
+        std::cout << "## waitForStopSignal received signal " << signal << std::endl;
+        server.retireSharedMemory();
+        _exit(EXIT_SUCCESS);
     }
 }
 
@@ -583,9 +1149,31 @@ int main(int argc, char* argv[]) {
     int n = std::atoi(argv[2]);
     int tcpPort = std::atoi(argv[3]);
 
+    /* Select Transport: P2P_TRANSPORT=shm gossips with co-located neighbors over shared memory */
+    Transport transport = Transport::UDP;
+    const char* transportEnv = std::getenv("P2P_TRANSPORT");
+    if (transportEnv != nullptr && std::string(transportEnv) == "shm") {
+        transport = Transport::SHM;
+    }
+
+    /* Select Fan-out: P2P_RUMOR_FANOUT sets how many neighbors each new rumor is sent to */
+    int rumorFanout = DEFAULT_RUMOR_FANOUT;
+    const char* fanoutEnv = std::getenv("P2P_RUMOR_FANOUT");
+    if (fanoutEnv != nullptr && std::atoi(fanoutEnv) > 0) {
+        rumorFanout = std::atoi(fanoutEnv);
+    }
+
+    /* Block SIGTERM/SIGINT in every thread so only the signal thread handles them */
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
     /* Start Server */
-    P2PServer server(index, n, tcpPort);
+    P2PServer server(index, n, tcpPort, transport, rumorFanout);
     server.start();
+    std::thread(waitForStopSignal, std::ref(server), signals).detach();
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
     server.waitForThreadsToFinish();
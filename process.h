@@ -2,17 +2,35 @@
 #define PROCESS_H
 
 #include <unordered_map>
+#include <map>
 #include <vector>
 #include <string>
 #include <thread>
 #include <atomic>
 #include <condition_variable>
+#include <mutex>
+#include <cstdint>
+#include <sys/types.h>
+#include <chrono>
 
 constexpr int MAX_MESSAGE_SIZE = 200;
 constexpr int MAX_MESSAGES = 1000;
 constexpr int MAX_PEERS = 4;
 constexpr int MAX_BUFFER_SIZE = 1024;
 constexpr int ROOT_ID = 40000;
+constexpr int SHM_RING_SLOTS = 256; // Must be a power of two
+constexpr int SHM_WAIT_TIMEOUT_MS = 100;
+constexpr int SHM_ATTACH_RETRY_MS = 1000;
+constexpr const char* SHM_NAME_PREFIX = "/p2p_gossip_";
+constexpr int DEFAULT_RUMOR_FANOUT = 1;
+constexpr int MAX_RUMOR_RETRIES = 5;
+constexpr int RUMOR_INITIAL_RTO_MS = 200;
+constexpr int RUMOR_MIN_RTO_MS = 5;
+constexpr int RUMOR_MAX_RTO_MS = 2000;
+constexpr int TIMER_TICK_MS = 1;
+constexpr int TIMER_WHEEL_BITS = 6;
+constexpr int TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_BITS;
+constexpr int TIMER_WHEEL_LEVELS = 3;
 
 
 struct DatabaseEntry {
@@ -21,6 +39,81 @@ struct DatabaseEntry {
 };
 
 
+enum class Transport {
+    UDP,
+    SHM
+};
+
+
+struct ShmSlot {
+    std::atomic<uint64_t> sequence;
+    uint32_t length;
+    char data[MAX_BUFFER_SIZE];
+};
+
+
+// Bounded MPSC ring living in POSIX shared memory. Every node owns one ring named
+// SHM_NAME_PREFIX + udpPort; neighbors push frames into it and the owner drains it.
+struct ShmRing {
+    std::atomic<uint32_t> ready;     // 0 while initializing or after the owner retired it
+    std::atomic<uint32_t> wakeSeq;   // futex word, bumped on every push
+    std::atomic<uint32_t> sleeping;  // set by the owner before it waits on wakeSeq
+    int ownerPid;
+    alignas(64) std::atomic<uint64_t> enqueuePos;
+    alignas(64) std::atomic<uint64_t> dequeuePos;
+    ShmSlot slots[SHM_RING_SLOTS];
+};
+
+
+// A rumor sent to a neighbor that has not yet answered with a status covering it
+struct OutstandingRumor {
+    int neighborPort;
+    int ownerPort;
+    int seqnum;
+    int retries = 0;
+    bool retransmitted = false; // Sent more than once, so its ack is no RTT sample (Karn's algorithm)
+    std::string message;
+    std::chrono::steady_clock::time_point sentAt;
+    uint64_t expiryTick = 0;
+};
+
+
+// Smoothed round-trip estimate for one neighbor (RFC 6298)
+struct RttEstimate {
+    bool measured = false;
+    double srttMs = 0;
+    double rttvarMs = 0;
+    int rtoMs = RUMOR_INITIAL_RTO_MS;
+};
+
+
+// Hierarchical timing wheel: level l holds timers expiring within TIMER_WHEEL_SLOTS^(l+1) ticks and
+// cascades them into the level below as the wheel turns.
+class TimerWheel {
+private:
+    struct Timer {
+        uint64_t id;
+        uint64_t expiryTick;
+    };
+
+    uint64_t tick;
+    size_t size;
+    std::vector<Timer> slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+
+    void place(const Timer& timer);
+    void cascade(int level);
+
+public:
+    TimerWheel();
+
+    uint64_t schedule(uint64_t id, uint64_t expiryTick);
+    bool cancel(uint64_t id, uint64_t expiryTick);
+    void advance(uint64_t nowTick, std::vector<uint64_t>& expired);
+    uint64_t nextExpiryTick() const;
+    bool empty() const;
+};
+
+
 class P2PServer {
 private:
     int index;
@@ -29,17 +122,38 @@ private:
     int udpPort;
     int tcpSocket;
     int udpSocket;
+    Transport transport;
+    ShmRing* shmRing;
+    bool shmRetired;
+    dev_t shmRingDev; // Identify our ring so we never unlink one a restarted node created under the same name
+    ino_t shmRingIno;
+    std::unordered_map<int, ShmRing*> peerRings; // Key: neighborUdpPort, Value: mapped ring
+    std::unordered_map<int, std::chrono::steady_clock::time_point> peerRingRetryAt; // Key: neighborUdpPort, Value: next attach attempt
+    int rumorFanout;
+    uint64_t nextRumorId;
+    std::unordered_map<uint64_t, OutstandingRumor> outstandingRumors; // Key: timerId, Value: OutstandingRumor
+    std::unordered_map<int, std::map<std::pair<int, int>, uint64_t>> outstandingByNeighbor; // Key: neighborUdpPort, Value: (ownerPort, seqnum) -> timerId
+    std::unordered_map<int, RttEstimate> rttEstimates; // Key: neighborUdpPort, Value: RttEstimate
+    TimerWheel retransmitWheel;
+    std::chrono::steady_clock::time_point wheelEpoch;
     std::atomic<bool> running;
     std::unordered_map<int, DatabaseEntry> database; // Key: ownerUdpPort, Value: DatabaseEntry
     std::thread proxyThread;
     std::thread neighborThread;
     std::thread statusBroadcastThread;
+    std::thread shmThread;
+    std::thread retransmitThread;
     std::condition_variable cv;
+    std::condition_variable retransmitCv;
     std::mutex cv_m;
     std::mutex databaseMutex;
+    std::mutex gossipMutex;
+    std::mutex peerRingsMutex;
+    std::mutex shmRingMutex;
+    std::mutex rumorMutex;
 
 public:
-    P2PServer(int index, int n, int tcpPort);
+    P2PServer(int index, int n, int tcpPort, Transport transport = Transport::UDP, int rumorFanout = DEFAULT_RUMOR_FANOUT);
     ~P2PServer();
 
     void start();
@@ -62,6 +176,7 @@ public:
     void neighborCommunication();
     void initializeUDPConnection();
     bool sendUDPMessage(int receiverPort, const std::string& message);
+    bool sendGossipMessage(int receiverPort, const std::string& message);
     void handleGossipMessage(const std::string& message);
     void handleRumorMessage(const std::string& message);
     std::string constructStatusMessage(int ownerPort);
@@ -70,6 +185,20 @@ public:
 
     void broadcastStatusPeriodically();
     void broadcastStatusToNeighbors();
+
+    void retransmitRumorsPeriodically();
+    uint64_t currentTick() const;
+    void trackRumor(int neighborPort, int ownerPort, int seqnum, const std::string& message);
+    void acknowledgeRumors(int neighborPort, const std::vector<std::pair<int, int>>& statusPairs);
+    void updateRttEstimate(int neighborPort, double sampleMs);
+
+    void shmCommunication();
+    void initializeSharedMemory();
+    void retireSharedMemory();
+    void closeSharedMemory();
+    ShmRing* attachPeerRing(int peerPort);
+    void detachPeerRing(int peerPort);
+    bool sendShmMessage(int receiverPort, const std::string& message);
 };
 
 #endif
\ No newline at end of file